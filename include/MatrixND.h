@@ -15,10 +15,19 @@
 #if defined _DEBUG
 #undef _DEBUG
 #include<vector>
+#include<memory>
+#include<functional>
+#include<list>
+#include<map>
 #define _DEBUG
 #else
 #include<vector>
+#include<memory>
+#include<functional>
+#include<list>
+#include<map>
 #endif
+#include<stdint.h>
 //defined to prevent dependency on intsafe.h for Mac and Linux platforms
 typedef unsigned int UINT32;
 typedef unsigned short UINT16;
@@ -37,19 +46,82 @@ struct OperatingDimensions_t
 	DllExport void set(UINT16 da, UINT16 db);
 };
 
+/*These mirror the structures of dlpack.h (v0.6 and later) field for field so
+tensors can be handed to and taken from other libraries in place without this
+header depending on dlpack itself. Cast to DLManagedTensor* at the boundary.*/
+struct MatrixND_DLDevice
+{
+	int32_t device_type;
+	int32_t device_id;
+};
+
+struct MatrixND_DLDataType
+{
+	uint8_t code;
+	uint8_t bits;
+	uint16_t lanes;
+};
+
+struct MatrixND_DLTensor
+{
+	void* data;
+	MatrixND_DLDevice device;
+	int32_t ndim;
+	MatrixND_DLDataType dtype;
+	int64_t* shape;
+	int64_t* strides;
+	uint64_t byte_offset;
+};
+
+struct MatrixND_DLManagedTensor
+{
+	MatrixND_DLTensor dl_tensor;
+	void* manager_ctx;
+	void (*deleter)(MatrixND_DLManagedTensor* self);
+};
+
+//Called once the last matrix using an adopted buffer is gone
+typedef std::function<void(float*)> MatrixDeleter_t;
+
+class FactoredMatrixND;
+class LiveProductND;
+
 class MatrixND
 {
+	friend class FactoredMatrixND;
+	friend class LiveProductND;
+	friend class CachedMatrixND;
 public:
 	//Constructors
 	DllExport MatrixND(std::vector<UINT32> dimensions);
+	/*Uses data in place as storage laid out like any other MatrixND, the first
+	dimension being the fastest. A C order (row major) buffer of shape (a, b, c)
+	is therefore wrapped in place with the dimensions {c, b, a}. With a deleter the buffer is adopted and the
+	deleter runs when the last copy of the matrix is gone, without one the buffer
+	is only borrowed and must outlive the matrix.*/
+	DllExport MatrixND(float* data, std::vector<UINT32> dimensions, MatrixDeleter_t deleter = MatrixDeleter_t());
+	/*Strides are in elements. Data is only used in place when the strides match
+	the layout above and it is aligned for float, otherwise the values are copied
+	into new storage and an adopted buffer is given back to its deleter right away*/
+	DllExport MatrixND(float* data, std::vector<UINT32> dimensions, const std::vector<UINT32>& strides,
+		MatrixDeleter_t deleter = MatrixDeleter_t());
+	/*Takes ownership of a DLPack tensor, calling its deleter when done with it.
+	DLPack axis ndim - 1 - k becomes dimension k so compact C order tensors are
+	used in place. Only float32 tensors on the CPU are accepted, anything else
+	gives an empty matrix*/
+	DllExport MatrixND(MatrixND_DLManagedTensor* tensor);
 	DllExport ~MatrixND(void);
 private:
 	//Class Members
 	float* m_pfData;
 	UINT32* m_piDimensions;
+	//In elements, always the dense layout of m_piDimensions
+	UINT32* m_piStrides;
 	UINT16 m_iDimensionality;
 	UINT32 m_iElements;
 	OperatingDimensions_t m_OperatingDimensions;
+	//Keeps an adopted buffer alive across copies, empty for internal storage
+	std::shared_ptr<float> m_spExternal;
 	/*This is to keep someone from modifying a non-existent
 	reference and to maintain external memory security*/
 	float m_modPrevent;
@@ -73,8 +145,20 @@ public:
 	DllExport MatrixND& multiply(MatrixND other);
 
 	DllExport bool equals(MatrixND other) const;
+	/*Hash of the dimensions and values. Matrices that equals() accepts give the
+	same hash as -0 and +0 are hashed alike*/
+	DllExport uint64_t contentHash(void) const;
 
 	DllExport MatrixND& outerProduct(MatrixND other);
+	/*Same result as outerProduct but only the two operands are kept,
+	see FactoredMatrixND below*/
+	DllExport FactoredMatrixND factoredOuterProduct(MatrixND other);
+
+	DllExport float sum(void) const;
+	//The summed dimension is kept with a size of one
+	DllExport MatrixND sumAlong(UINT16 dimension) const;
+	//Copies the values at index of dimension, which is kept with a size of one
+	DllExport MatrixND slice(UINT16 dimension, UINT32 index) const;
 
 	DllExport MatrixND& operator+=(MatrixND other);
 	DllExport MatrixND& operator-=(MatrixND other);
@@ -96,12 +180,23 @@ public:
 	DllExport void copy(MatrixND* target);
 	DllExport void setOperatingDimensions(UINT16 da, UINT16 db);
 
+	/*Exports the storage without copying it. Dimension k becomes DLPack axis
+	ndim - 1 - k so the tensor is compact in C order. The returned tensor keeps
+	the storage alive until its deleter is called, which the consumer must do once*/
+	DllExport MatrixND_DLManagedTensor* toDLPack(void) const;
+
 	//Functions only appears in header
 	DllExport inline UINT16 getDimensionality(void) const{return m_iDimensionality;}
 	DllExport inline UINT32 getElements(void) const{return m_iElements;}
 	DllExport inline UINT32* const getDimensions(void) const{return m_piDimensions;}
+	DllExport inline UINT32* getStrides(void) const{return m_piStrides;}
+	DllExport inline float* getData(void) const{return m_pfData;}
+	DllExport inline OperatingDimensions_t getOperatingDimensions(void) const{return m_OperatingDimensions;}
 private:
 	//Private Functions
+	void setDimensions(const std::vector<UINT32>& dimensions);
+	void adopt(float* data, const std::vector<int64_t>& strides, MatrixDeleter_t deleter);
+
 	std::vector<UINT32> getPositionFromIndex(UINT32 index) const;
 	UINT32 getIndexFromPosition(std::vector<UINT32> pos) const;
 	UINT32* getPositionFromIndexFast(UINT32 index) const;
@@ -113,6 +208,237 @@ private:
 	inline bool compareDimensions(MatrixND other) const;
 
 	bool multipliable(MatrixND other) const;
+
+	/*Multiplies every operating plane of a by the matching plane of b into out.
+	Taking the strides separately from the dimensions lets blocks and slices of a
+	larger matrix be used in place without copying them out first*/
+	static void multiplyBlock(const float* a, const UINT32* aDimensions, const UINT32* aStrides,
+		const float* b, const UINT32* bDimensions, const UINT32* bStrides,
+		float* out, const UINT32* outStrides, UINT16 dimensionality, OperatingDimensions_t dims, float scale);
+};
+
+/*Represents the outer product of two matrices without building it. The
+dimensions of the first operand come before the ones of the second and the
+value at a position is the product of the two operand values. Operations
+work on the operands where the rank one structure allows it and only build
+the full matrix when they cannot.*/
+class FactoredMatrixND
+{
+public:
+	//Constructors
+	DllExport FactoredMatrixND(MatrixND first, MatrixND second);
+private:
+	//Class Members
+	MatrixND m_First;
+	MatrixND m_Second;
+	OperatingDimensions_t m_OperatingDimensions;
+public:
+	//Public functions
+	DllExport float at(const std::vector<UINT32>& position) const;
+
+	DllExport MatrixND materialize(void) const;
+	DllExport MatrixND materializeSlice(UINT16 dimension, UINT32 index) const;
+	DllExport FactoredMatrixND slice(UINT16 dimension, UINT32 index) const;
+
+	DllExport FactoredMatrixND& scalarMultiply(float multiple);
+	DllExport float sum(void) const;
+	DllExport FactoredMatrixND sumAlong(UINT16 dimension) const;
+
+	/*Multiplies without building the full matrix and stores the result in
+	product. Returns false and leaves product alone when the two are not multipliable*/
+	DllExport bool multiply(MatrixND other, MatrixND* product) const;
+	/*Stays factored when both matrices are split at the same dimension and
+	either the operating dimensions fall inside the same operand or, when they
+	straddle the split, one of the inner operands is a vector along its operating
+	dimension. Returns false and changes nothing otherwise, multiply by
+	other.materialize() instead in that case*/
+	DllExport bool multiply(FactoredMatrixND other);
+
+	DllExport void setOperatingDimensions(UINT16 da, UINT16 db);
+
+	//Functions only appears in header
+	DllExport inline UINT16 getDimensionality(void) const{return m_First.m_iDimensionality + m_Second.m_iDimensionality;}
+	DllExport inline UINT32 getElements(void) const{return m_First.m_iElements * m_Second.m_iElements;}
+	DllExport inline const MatrixND& getFirst(void) const{return m_First;}
+	DllExport inline const MatrixND& getSecond(void) const{return m_Second;}
+	DllExport inline OperatingDimensions_t getOperatingDimensions(void) const{return m_OperatingDimensions;}
+private:
+	//Private Functions
+	inline bool inFirst(UINT16 dimension) const{return dimension <= m_First.m_iDimensionality;}
+	std::vector<UINT32> getDimensionVector(void) const;
+	bool multiplyStraddling(FactoredMatrixND other);
+	//Contracts matrix along dimension with vector, keeping the dimension with a size of one
+	static MatrixND contractFibres(const MatrixND& matrix, UINT16 dimension, const float* vector);
+	//Multiplies every fibre of target along dimension by the matching value of factors
+	static void scaleFibres(MatrixND& target, UINT16 dimension, const MatrixND& factors);
+};
+
+/*Keeps the product of two matrices up to date while they change. The operands
+are split into slices along a batch dimension which must not be an operating
+dimension, and refresh only recomputes the slices of the product whose operand
+slices changed. Changes made through the update functions are applied to the
+product right away as rank k updates of the operating plane they touch. An
+invalid batch dimension treats both operands as a single slice.*/
+class LiveProductND
+{
+public:
+	//Constructors
+	//The operating dimensions are taken from left
+	DllExport LiveProductND(MatrixND left, MatrixND right, UINT16 batchDimension);
+private:
+	//Class Members
+	MatrixND m_Left;
+	MatrixND m_Right;
+	MatrixND m_Product;
+	OperatingDimensions_t m_OperatingDimensions;
+	UINT16 m_iBatchDimension;
+	bool m_bMultipliable;
+	//One flag per slice along the batch dimension, shared by both operands
+	std::vector<bool> m_DirtySlices;
+public:
+	//Public functions
+	/*Marks the slice holding the position dirty whether or not the returned
+	reference is written through*/
+	DllExport float& leftAt(const std::vector<UINT32>& position);
+	DllExport float& rightAt(const std::vector<UINT32>& position);
+
+	//The slice must have the operand's dimensions with a size of one in the batch dimension
+	DllExport void setLeftSlice(UINT32 index, MatrixND slice);
+	DllExport void setRightSlice(UINT32 index, MatrixND slice);
+	DllExport void markDirty(UINT32 index);
+
+	/*Adds u times v transposed to the operating plane of the left operand that
+	holds position, the operating values of position being ignored. u holds the
+	rows and v the columns of the plane along its first dimension and both have
+	the rank of the update as their second dimension*/
+	DllExport void updateLeft(const std::vector<UINT32>& position, MatrixND u, MatrixND v);
+	DllExport void updateRight(const std::vector<UINT32>& position, MatrixND u, MatrixND v);
+
+	DllExport const MatrixND& refresh(void);
+
+	//Functions only appears in header
+	DllExport inline const MatrixND& getProduct(void) const{return m_Product;}
+	DllExport inline const MatrixND& getLeft(void) const{return m_Left;}
+	DllExport inline const MatrixND& getRight(void) const{return m_Right;}
+	DllExport inline UINT16 getBatchDimension(void) const{return m_iBatchDimension;}
+private:
+	//Private Functions
+	UINT32 getSliceFromPosition(const std::vector<UINT32>& position) const;
+	void setSlice(MatrixND& target, UINT32 index, MatrixND slice);
+	bool getPlaneOffset(const MatrixND& matrix, const std::vector<UINT32>& position, UINT32* offset) const;
+	bool validUpdate(UINT32 rows, UINT32 cols, MatrixND u, MatrixND v) const;
+	void recomputeSlice(UINT32 index);
+};
+
+/*Read only handle on a result held by MatrixNDCache. Copies of a MatrixND share
+their storage and its operations change it in place, so the cached matrix is
+never handed out itself. toMatrix gives a copy that can be changed freely.*/
+class CachedMatrixND
+{
+	friend class MatrixNDCache;
+private:
+	//Constructors
+	CachedMatrixND(std::shared_ptr<const MatrixND> matrix);
+	//Class Members
+	std::shared_ptr<const MatrixND> m_spMatrix;
+public:
+	//Public functions
+	DllExport float at(UINT32 index) const;
+	DllExport float at(const std::vector<UINT32>& position) const;
+	DllExport MatrixND toMatrix(void) const;
+	DllExport bool equals(MatrixND other) const;
+
+	//Functions only appears in header
+	DllExport inline UINT16 getDimensionality(void) const{return m_spMatrix->getDimensionality();}
+	DllExport inline UINT32 getElements(void) const{return m_spMatrix->getElements();}
+	DllExport inline const UINT32* getDimensions(void) const{return m_spMatrix->getDimensions();}
+	DllExport inline const UINT32* getStrides(void) const{return m_spMatrix->getStrides();}
+	DllExport inline const float* getData(void) const{return m_spMatrix->getData();}
+	DllExport inline OperatingDimensions_t getOperatingDimensions(void) const{return m_spMatrix->getOperatingDimensions();}
+};
+
+/*An opt in cache of identity, transpose and multiply results, bounded by the
+bytes of the results it holds and dropping the least recently used first.
+Operands are recognised by their dimensions and content hashes together with
+the operation and operating dimensions, so unchanged inputs hit even when they
+are different objects. Results are shared between every caller through CachedMatrixND.*/
+class MatrixNDCache
+{
+public:
+	//Constructors
+	DllExport MatrixNDCache(size_t capacityBytes);
+private:
+	enum Operation_t
+	{
+		OPERATION_IDENTITY,
+		OPERATION_TRANSPOSE,
+		OPERATION_MULTIPLY
+	};
+
+	/*An operand is recognised by its dimensions and two independent hashes of its
+	values. Two different operands matching on all of them is accepted as too
+	unlikely to guard against further*/
+	struct Operand_t
+	{
+		std::vector<UINT32> dimensions;
+		uint64_t hash;
+		uint64_t check;
+
+		bool operator<(const Operand_t& other) const;
+	};
+
+	struct Key_t
+	{
+		Operation_t operation;
+		UINT16 da;
+		UINT16 db;
+		Operand_t first;
+		Operand_t second;
+
+		bool operator<(const Key_t& other) const;
+	};
+
+	struct Entry_t
+	{
+		Key_t key;
+		std::shared_ptr<const MatrixND> result;
+		size_t bytes;
+	};
+
+	//Class Members
+	//Most recently used first
+	std::list<Entry_t> m_Entries;
+	std::map<Key_t, std::list<Entry_t>::iterator> m_Index;
+	size_t m_iCapacity;
+	size_t m_iBytes;
+	uint64_t m_iHits;
+	uint64_t m_iMisses;
+public:
+	//Public functions
+	DllExport CachedMatrixND generateIdentity(std::vector<UINT32>& dimensions, OperatingDimensions_t dims);
+	DllExport CachedMatrixND transpose(MatrixND matIn, OperatingDimensions_t dims);
+	//Uses the operating dimensions of left like MatrixND::multiply
+	DllExport CachedMatrixND multiply(MatrixND left, MatrixND right);
+
+	DllExport void clear(void);
+	DllExport void setCapacity(size_t capacityBytes);
+	DllExport double getHitRate(void) const;
+
+	//Functions only appears in header
+	DllExport inline uint64_t getHits(void) const{return m_iHits;}
+	DllExport inline uint64_t getMisses(void) const{return m_iMisses;}
+	DllExport inline size_t getBytes(void) const{return m_iBytes;}
+	DllExport inline size_t getCapacity(void) const{return m_iCapacity;}
+	DllExport inline size_t getEntries(void) const{return m_Entries.size();}
+private:
+	//Private Functions
+	std::shared_ptr<const MatrixND> find(const Key_t& key);
+	std::shared_ptr<const MatrixND> insert(const Key_t& key, std::shared_ptr<const MatrixND> result);
+	void evict(size_t incoming);
+	static std::shared_ptr<const MatrixND> share(MatrixND result, const float* input);
+	static Operand_t describe(const MatrixND& matrix);
+	//Hash of the values built differently from MatrixND::contentHash so the two collide independently
+	static uint64_t checkHash(const MatrixND& matrix);
 };
 /***********************************************Comment*********************************************************
 *The following links will show the papers used to define the rules being used in the program
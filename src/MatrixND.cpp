@@ -1,4 +1,6 @@
 #include "MatrixND.h"
+#include <cstring>
+#include <algorithm>
 
 //--Starting point for methods of struct OperatingDimensions_t--
 OperatingDimensions_t::OperatingDimensions_t(void)
@@ -32,14 +34,7 @@ void OperatingDimensions_t::set(UINT16 da, UINT16 db)
 //---------Starting point for methods of class MatrixND----------
 MatrixND::MatrixND(std::vector<UINT32> dimensions)
 {
-	m_iDimensionality = dimensions.size();
-	m_iElements = 1;
-	m_piDimensions = new UINT32[m_iDimensionality];
-	for (UINT16 i = 0; i < m_iDimensionality; i++)
-	{
-		m_piDimensions[i] = dimensions.at(i);
-		m_iElements *= m_piDimensions[i];
-	}
+	setDimensions(dimensions);
 	m_pfData = new float[m_iElements];
 	for (UINT32 j = 0; j < m_iElements; j++)
 	{
@@ -48,6 +43,68 @@ MatrixND::MatrixND(std::vector<UINT32> dimensions)
 	m_modPrevent = 0;
 }
 
+MatrixND::MatrixND(float* data, std::vector<UINT32> dimensions, MatrixDeleter_t deleter)
+{
+	setDimensions(dimensions);
+	adopt(data, std::vector<int64_t>(m_piStrides, m_piStrides + m_iDimensionality), deleter);
+	m_modPrevent = 0;
+}
+
+MatrixND::MatrixND(float* data, std::vector<UINT32> dimensions, const std::vector<UINT32>& strides, MatrixDeleter_t deleter)
+{
+	setDimensions(dimensions);
+	//Missing strides are taken from the dense layout
+	std::vector<int64_t> elementStrides(m_piStrides, m_piStrides + m_iDimensionality);
+	for (UINT16 i = 0; i < m_iDimensionality && i < strides.size(); i++)
+	{
+		elementStrides.at(i) = strides.at(i);
+	}
+	adopt(data, elementStrides, deleter);
+	m_modPrevent = 0;
+}
+
+MatrixND::MatrixND(MatrixND_DLManagedTensor* tensor)
+{
+	m_modPrevent = 0;
+	const MatrixND_DLTensor& dl = tensor->dl_tensor;
+	//kDLCPU is 1 and kDLFloat is 2 in dlpack.h
+	bool supported = dl.device.device_type == 1 && dl.dtype.code == 2 && dl.dtype.bits == 32
+		&& dl.dtype.lanes == 1 && dl.ndim >= 0;
+	//DLPack axis ndim - 1 - k is MatrixND dimension k, see toDLPack
+	std::vector<UINT32> dimensions;
+	if (supported)
+	{
+		dimensions.assign(dl.shape, dl.shape + dl.ndim);
+		std::reverse(dimensions.begin(), dimensions.end());
+	}
+	setDimensions(dimensions);
+	if (!supported)
+	{
+		m_iElements = 0;
+		m_pfData = new float[1];
+		if (tensor->deleter)
+			tensor->deleter(tensor);
+		return;
+	}
+
+	/*A missing strides array means a compact tensor with the last axis fastest,
+	which with the axes reversed is exactly the dense MatrixND layout*/
+	std::vector<int64_t> strides(m_piStrides, m_piStrides + m_iDimensionality);
+	if (dl.strides)
+	{
+		for (UINT16 k = 0; k < m_iDimensionality; k++)
+		{
+			strides.at(k) = dl.strides[m_iDimensionality - 1 - k];
+		}
+	}
+	float* data = (float*)((char*)dl.data + dl.byte_offset);
+	adopt(data, strides, [tensor](float*)
+	{
+		if (tensor->deleter)
+			tensor->deleter(tensor);
+	});
+}
+
 MatrixND::~MatrixND(void)
 {
 }
@@ -82,7 +139,7 @@ float& MatrixND::atFast(UINT32* position)
 
 MatrixND MatrixND::transpose(MatrixND matIn, OperatingDimensions_t dims)
 {
-	if (!matIn.isInMatrix(dims.da) || !matIn.isInMatrix(dims.db)) 
+	if (!matIn.dimensionExists(dims.da) || !matIn.dimensionExists(dims.db)) 
 		return matIn;
 	std::vector<UINT32> dimensions(matIn.m_iDimensionality);
 	for (UINT32 i = 0; i < matIn.m_iDimensionality; i++)
@@ -92,14 +149,24 @@ MatrixND MatrixND::transpose(MatrixND matIn, OperatingDimensions_t dims)
 	dimensions.at(dims.da - 1) = matIn.m_piDimensions[dims.db - 1];
 	dimensions.at(dims.db - 1) = matIn.m_piDimensions[dims.da - 1];
 	MatrixND matOut(dimensions);
-	for (UINT32 j = 0; j < matOut.m_iElements; j++)
+	//Strides of the output for each input dimension, swapped at the appropriate dimensions
+	std::vector<UINT32> strides(matOut.m_piStrides, matOut.m_piStrides + matOut.m_iDimensionality);
+	strides.at(dims.da - 1) = matOut.m_piStrides[dims.db - 1];
+	strides.at(dims.db - 1) = matOut.m_piStrides[dims.da - 1];
+	std::vector<UINT32> position(matIn.m_iDimensionality, 0);
+	UINT32 offset = 0;
+	for (UINT32 j = 0; j < matIn.m_iElements; j++)
 	{
-		UINT32* position = matOut.getPositionFromIndexFast(j);
-		UINT32* newPosition = matOut.getPositionFromIndexFast(j);
-		//Swaps the position values at the appropriate dimensions
-		newPosition[dims.da - 1] = position[dims.db - 1];
-		newPosition[dims.db - 1] = position[dims.da - 1];
-		matOut.atFast(j) = matIn.atFast(newPosition);
+		matOut.m_pfData[offset] = matIn.m_pfData[j];
+		for (UINT16 d = 0; d < matIn.m_iDimensionality; d++)
+		{
+			position[d]++;
+			offset += strides[d];
+			if (position[d] < matIn.m_piDimensions[d])
+				break;
+			offset -= strides[d] * matIn.m_piDimensions[d];
+			position[d] = 0;
+		}
 	}
 	return matOut;
 }
@@ -107,14 +174,16 @@ MatrixND MatrixND::transpose(MatrixND matIn, OperatingDimensions_t dims)
 MatrixND MatrixND::generateIdentity(std::vector<UINT32>& dimensions, OperatingDimensions_t dims)
 {
 	MatrixND identity(dimensions);
-	if (dimensions.at(dims.da - 1) == dimensions.at(dims.db - 1))
+	if (identity.dimensionExists(dims.db) && dimensions.at(dims.da - 1) == dimensions.at(dims.db - 1))
 	{
+		UINT32 n = dimensions.at(dims.da - 1);
+		UINT32 daStride = identity.m_piStrides[dims.da - 1];
+		UINT32 dbStride = identity.m_piStrides[dims.db - 1];
 		for (UINT32 i = 0; i < identity.m_iElements; i++)
 		{
-			UINT32* position = identity.getPositionFromIndexFast(i);
-			if (position[dims.da - 1] == position[dims.db - 1])
+			if ((i / daStride) % n == (i / dbStride) % n)
 			{
-				identity.atFast(i) = 1.0f;
+				identity.m_pfData[i] = 1.0f;
 			}
 		}
 	}
@@ -160,29 +229,17 @@ MatrixND& MatrixND::multiply(MatrixND other)
 {
 	if (multipliable(other))
 	{
-		UINT32 n = m_piDimensions[m_OperatingDimensions.da];
 		std::vector<UINT32> dimensions(this->m_iDimensionality);
 		for (UINT32 dimension = 0; dimension < m_iDimensionality; dimension++)
 		{
 			dimensions.at(dimension) = this->m_piDimensions[dimension];
 		}
-		dimensions.at(m_OperatingDimensions.da - 1) = this->m_piDimensions[m_OperatingDimensions.da - 1];
-		dimensions.at(m_OperatingDimensions.db - 1) = this->m_piDimensions[m_OperatingDimensions.db - 1];
+		dimensions.at(m_OperatingDimensions.db - 1) = other.m_piDimensions[m_OperatingDimensions.db - 1];
 
 		MatrixND matOut(dimensions);
-		for (UINT32 i = 0; i < matOut.m_iElements; i++)
-		{
-			float sum = 0;
-			for (UINT32 x = 0; x < n; x++)
-			{
-				UINT32* positionA = getPositionFromIndexFast(i);
-				UINT32* positionB = getPositionFromIndexFast(i);
-				positionA[m_OperatingDimensions.db - 1] = x + 1;
-				positionB[m_OperatingDimensions.da - 1] = x + 1;
-				sum += (this->atFast(positionA)) * (other.atFast(positionB));
-			}
-			matOut.atFast(i) = sum;
-		}
+		multiplyBlock(this->m_pfData, this->m_piDimensions, this->m_piStrides,
+			other.m_pfData, other.m_piDimensions, other.m_piStrides,
+			matOut.m_pfData, matOut.m_piStrides, m_iDimensionality, m_OperatingDimensions, 1.0f);
 		matOut.copy(this);
 	}
 	return *this;
@@ -190,50 +247,109 @@ MatrixND& MatrixND::multiply(MatrixND other)
 
 MatrixND& MatrixND::outerProduct(MatrixND other)
 {
-	UINT32 dimensionality = this->m_iDimensionality + other.m_iDimensionality;
-	std::vector<UINT32> dimensions(dimensionality);
-	for (UINT32 i = 0; i < dimensionality; i++)
+	factoredOuterProduct(other).materialize().copy(this);
+	return *this;
+}
+
+FactoredMatrixND MatrixND::factoredOuterProduct(MatrixND other)
+{
+	return FactoredMatrixND(*this, other);
+}
+
+float MatrixND::sum(void) const
+{
+	float total = 0;
+	for (UINT32 i = 0; i < m_iElements; i++)
 	{
-		if (i < this->m_iDimensionality)
-		{
-			dimensions.at(i) = this->m_piDimensions[i];
-		}
-		else
-		{
-			dimensions.at(i) = other.m_piDimensions[i - this->m_iDimensionality];
-		}
+		total += m_pfData[i];
 	}
+	return total;
+}
 
+MatrixND MatrixND::sumAlong(UINT16 dimension) const
+{
+	if (dimension == 0 || !dimensionExists(dimension))
+		return *this;
+	std::vector<UINT32> dimensions(m_piDimensions, m_piDimensions + m_iDimensionality);
+	dimensions.at(dimension - 1) = 1;
 	MatrixND matOut(dimensions);
-	for (UINT32 j = 0; j < this->m_iElements; j++)
+	//inner is the number of elements in one step of the summed dimension
+	UINT32 inner = 1;
+	for (UINT16 d = 0; d < dimension - 1; d++)
 	{
-		UINT32* firstPosition = this->getPositionFromIndexFast(j);
-		float firstValue = this->atFast(j);
-
-		for (UINT32 k = 0; k < other.m_iElements; k++)
-		{
-			UINT32* secondPosition = this->getPositionFromIndexFast(k);
-			float secondValue = other.atFast(k);
+		inner *= m_piDimensions[d];
+	}
+	UINT32 span = inner * m_piDimensions[dimension - 1];
+	for (UINT32 i = 0; i < m_iElements; i++)
+	{
+		matOut.m_pfData[(i % inner) + (i / span) * inner] += m_pfData[i];
+	}
+	return matOut;
+}
 
-			UINT32* resultingPosition = new UINT32[dimensionality];
-			//Appending the two arrays to get the resulting position
-			for (UINT32 index = 0; index < dimensionality; index++)
-			{
-				if (index < this->m_iDimensionality)
-				{
-					resultingPosition[index] = firstPosition[index];
-				}
-				else
-				{
-					resultingPosition[index] = secondPosition[index - this->m_iDimensionality];
-				}
+MatrixND MatrixND::slice(UINT16 dimension, UINT32 index) const
+{
+	if (dimension == 0 || !dimensionExists(dimension))
+		return *this;
+	if (index == 0 || index > m_piDimensions[dimension - 1])
+		return *this;
+	std::vector<UINT32> dimensions(m_piDimensions, m_piDimensions + m_iDimensionality);
+	dimensions.at(dimension - 1) = 1;
+	MatrixND matOut(dimensions);
+	UINT32 inner = 1;
+	UINT32 outer = 1;
+	for (UINT16 d = 0; d < m_iDimensionality; d++)
+	{
+		if (d < dimension - 1)
+			inner *= m_piDimensions[d];
+		else if (d > dimension - 1)
+			outer *= m_piDimensions[d];
+	}
+	//Each run of inner elements is contiguous in both matrices
+	for (UINT32 o = 0; o < outer; o++)
+	{
+		memcpy(matOut.m_pfData + o * inner,
+			m_pfData + (o * m_piDimensions[dimension - 1] + index - 1) * inner,
+			sizeof(float) * inner);
+	}
+	return matOut;
+}
 
-			}
-			matOut.atFast(resultingPosition) = firstValue * secondValue;
+uint64_t MatrixND::contentHash(void) const
+{
+	//Four independent lanes so the loop is not held up by one long dependency chain
+	const uint64_t prime = 0x100000001b3ULL;
+	uint64_t lanes[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL, 0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL };
+	for (UINT16 d = 0; d < m_iDimensionality; d++)
+	{
+		lanes[0] = (lanes[0] ^ m_piDimensions[d]) * prime;
+	}
+	//Adding zero turns -0 into +0 so values that compare equal hash the same
+	UINT32 i = 0;
+	UINT32 word;
+	float value;
+	for (; i + 4 <= m_iElements; i += 4)
+	{
+		for (UINT32 lane = 0; lane < 4; lane++)
+		{
+			value = m_pfData[i + lane] + 0.0f;
+			memcpy(&word, &value, sizeof(UINT32));
+			lanes[lane] = (lanes[lane] ^ word) * prime;
 		}
 	}
-	matOut.copy(this);
-	return *this;
+	for (; i < m_iElements; i++)
+	{
+		value = m_pfData[i] + 0.0f;
+		memcpy(&word, &value, sizeof(UINT32));
+		lanes[0] = (lanes[0] ^ word) * prime;
+	}
+	uint64_t hash = m_iDimensionality;
+	for (UINT32 lane = 0; lane < 4; lane++)
+	{
+		hash = (hash ^ lanes[lane]) * prime;
+		hash ^= hash >> 29;
+	}
+	return hash;
 }
 
 bool MatrixND::equals(MatrixND other) const
@@ -319,11 +435,16 @@ void MatrixND::copy(MatrixND* target)
 	target->m_iDimensionality = this->m_iDimensionality;
 	target->m_iElements = this->m_iElements;
 	target->m_piDimensions = NULL;
+	target->m_piStrides = NULL;
 	target->m_pfData = NULL;
 	target->m_piDimensions = new UINT32[target->m_iDimensionality];
+	target->m_piStrides = new UINT32[target->m_iDimensionality];
 	target->m_pfData = new float[target->m_iElements];
 	memcpy(target->m_piDimensions, this->m_piDimensions, sizeof(UINT32) * this->m_iDimensionality);
-	memcpy(target->m_pfData, this->m_pfData, sizeof(UINT32) * this->m_iElements);
+	memcpy(target->m_piStrides, this->m_piStrides, sizeof(UINT32) * this->m_iDimensionality);
+	memcpy(target->m_pfData, this->m_pfData, sizeof(float) * this->m_iElements);
+	//The target owns fresh storage now so it lets go of any adopted buffer
+	target->m_spExternal.reset();
 }
 
 void MatrixND::setOperatingDimensions(UINT16 da, UINT16 db)
@@ -331,6 +452,107 @@ void MatrixND::setOperatingDimensions(UINT16 da, UINT16 db)
 	m_OperatingDimensions.set(da, db);
 }
 
+//What an exported tensor needs to stay valid until its deleter is called
+struct DLPackContext_t
+{
+	MatrixND owner;
+	std::vector<int64_t> shape;
+	std::vector<int64_t> strides;
+	MatrixND_DLManagedTensor tensor;
+
+	DLPackContext_t(const MatrixND& matrix) : owner(matrix) {}
+};
+
+static void deleteDLPackContext(MatrixND_DLManagedTensor* self)
+{
+	delete (DLPackContext_t*)self->manager_ctx;
+}
+
+MatrixND_DLManagedTensor* MatrixND::toDLPack(void) const
+{
+	DLPackContext_t* context = new DLPackContext_t(*this);
+	/*The axes are reversed so the first dimension, which is the fastest here,
+	is the last DLPack axis and the storage reads as an ordinary C order tensor*/
+	context->shape.assign(m_piDimensions, m_piDimensions + m_iDimensionality);
+	context->strides.assign(m_piStrides, m_piStrides + m_iDimensionality);
+	std::reverse(context->shape.begin(), context->shape.end());
+	std::reverse(context->strides.begin(), context->strides.end());
+
+	MatrixND_DLTensor& dl = context->tensor.dl_tensor;
+	dl.data = m_pfData;
+	dl.device.device_type = 1;
+	dl.device.device_id = 0;
+	dl.ndim = m_iDimensionality;
+	dl.dtype.code = 2;
+	dl.dtype.bits = 32;
+	dl.dtype.lanes = 1;
+	dl.shape = context->shape.empty() ? NULL : &context->shape[0];
+	dl.strides = context->strides.empty() ? NULL : &context->strides[0];
+	dl.byte_offset = 0;
+	context->tensor.manager_ctx = context;
+	context->tensor.deleter = deleteDLPackContext;
+	return &context->tensor;
+}
+
+void MatrixND::setDimensions(const std::vector<UINT32>& dimensions)
+{
+	m_iDimensionality = dimensions.size();
+	m_iElements = 1;
+	m_piDimensions = new UINT32[m_iDimensionality];
+	m_piStrides = new UINT32[m_iDimensionality];
+	for (UINT16 i = 0; i < m_iDimensionality; i++)
+	{
+		m_piDimensions[i] = dimensions.at(i);
+		m_piStrides[i] = m_iElements;
+		m_iElements *= m_piDimensions[i];
+	}
+}
+
+void MatrixND::adopt(float* data, const std::vector<int64_t>& strides, MatrixDeleter_t deleter)
+{
+	bool dense = data != NULL && ((uintptr_t)data % sizeof(float)) == 0;
+	for (UINT16 i = 0; i < m_iDimensionality && dense; i++)
+	{
+		//Strides of dimensions with one value are never followed
+		if (m_piDimensions[i] > 1 && strides.at(i) != (int64_t)m_piStrides[i])
+			dense = false;
+	}
+	if (dense)
+	{
+		m_pfData = data;
+		if (deleter)
+			m_spExternal = std::shared_ptr<float>(data, deleter);
+		return;
+	}
+
+	//Gathers the values by counting through the positions of the source
+	m_pfData = new float[m_iElements];
+	std::vector<UINT32> position(m_iDimensionality, 0);
+	int64_t offset = 0;
+	for (UINT32 i = 0; i < m_iElements && data != NULL; i++)
+	{
+		memcpy(&m_pfData[i], (char*)data + offset * (int64_t)sizeof(float), sizeof(float));
+		for (UINT16 d = 0; d < m_iDimensionality; d++)
+		{
+			position[d]++;
+			offset += strides.at(d);
+			if (position[d] < m_piDimensions[d])
+				break;
+			offset -= strides.at(d) * m_piDimensions[d];
+			position[d] = 0;
+		}
+	}
+	if (data == NULL)
+	{
+		for (UINT32 j = 0; j < m_iElements; j++)
+		{
+			m_pfData[j] = 0.0f;
+		}
+	}
+	if (deleter)
+		deleter(data);
+}
+
 //-------------------------Positioners-----------------------------
 
 std::vector<UINT32> MatrixND::getPositionFromIndex(UINT32 index) const
@@ -461,6 +683,8 @@ bool MatrixND::multipliable(MatrixND other) const
 {
 	if (m_iDimensionality != other.m_iDimensionality)
 		return false;
+	if (!dimensionExists(m_OperatingDimensions.db))
+		return false;
 	if (this->m_piDimensions[m_OperatingDimensions.db - 1] != other.m_piDimensions[m_OperatingDimensions.da - 1])
 		return false;
 	for (UINT16 d = 0; d < m_iDimensionality; d++)
@@ -471,4 +695,846 @@ bool MatrixND::multipliable(MatrixND other) const
 			return false;
 	}
 	return true;
-}
\ No newline at end of file
+}
+
+//------------------------Multiplication Kernel------------------------
+
+void MatrixND::multiplyBlock(const float* a, const UINT32* aDimensions, const UINT32* aStrides,
+	const float* b, const UINT32* bDimensions, const UINT32* bStrides,
+	float* out, const UINT32* outStrides, UINT16 dimensionality, OperatingDimensions_t dims, float scale)
+{
+	UINT16 p = dims.da - 1;
+	UINT16 q = dims.db - 1;
+	UINT32 planes = 1;
+	for (UINT16 d = 0; d < dimensionality; d++)
+	{
+		if (d != p && d != q)
+			planes *= aDimensions[d];
+	}
+	UINT32 rows = aDimensions[p];
+	UINT32 n = aDimensions[q];
+	UINT32 cols = bDimensions[q];
+
+	std::vector<UINT32> position(dimensionality, 0);
+	UINT32 aBase = 0;
+	UINT32 bBase = 0;
+	UINT32 outBase = 0;
+	for (UINT32 plane = 0; plane < planes; plane++)
+	{
+		for (UINT32 r = 0; r < rows; r++)
+		{
+			for (UINT32 c = 0; c < cols; c++)
+			{
+				float sum = 0;
+				UINT32 aIndex = aBase + r * aStrides[p];
+				UINT32 bIndex = bBase + c * bStrides[q];
+				for (UINT32 x = 0; x < n; x++)
+				{
+					sum += a[aIndex] * b[bIndex];
+					aIndex += aStrides[q];
+					bIndex += bStrides[p];
+				}
+				out[outBase + r * outStrides[p] + c * outStrides[q]] = scale * sum;
+			}
+		}
+		//Counts through the non operating dimensions to reach the next plane
+		for (UINT16 d = 0; d < dimensionality; d++)
+		{
+			if (d == p || d == q)
+				continue;
+			position[d]++;
+			aBase += aStrides[d];
+			bBase += bStrides[d];
+			outBase += outStrides[d];
+			if (position[d] < aDimensions[d])
+				break;
+			aBase -= aStrides[d] * aDimensions[d];
+			bBase -= bStrides[d] * aDimensions[d];
+			outBase -= outStrides[d] * aDimensions[d];
+			position[d] = 0;
+		}
+	}
+}
+
+//------Starting point for methods of class FactoredMatrixND-------
+FactoredMatrixND::FactoredMatrixND(MatrixND first, MatrixND second)
+	: m_First(first), m_Second(second)
+{
+	//The operands are copied so later changes to the originals do not leak in
+	first.copy(&m_First);
+	second.copy(&m_Second);
+}
+
+float FactoredMatrixND::at(const std::vector<UINT32>& position) const
+{
+	if (position.size() != getDimensionality())
+		return 0.0f;
+	std::vector<UINT32> firstPosition(position.begin(), position.begin() + m_First.m_iDimensionality);
+	std::vector<UINT32> secondPosition(position.begin() + m_First.m_iDimensionality, position.end());
+	if (!m_First.isInMatrix(firstPosition) || !m_Second.isInMatrix(secondPosition))
+		return 0.0f;
+	return m_First.m_pfData[m_First.getIndexFromPosition(firstPosition)]
+		* m_Second.m_pfData[m_Second.getIndexFromPosition(secondPosition)];
+}
+
+MatrixND FactoredMatrixND::materialize(void) const
+{
+	MatrixND matOut(getDimensionVector());
+	//The second operand's index changes once per block of the first operand's elements
+	UINT32 block = m_First.m_iElements;
+	for (UINT32 k = 0; k < m_Second.m_iElements; k++)
+	{
+		float secondValue = m_Second.m_pfData[k];
+		float* target = matOut.m_pfData + k * block;
+		for (UINT32 j = 0; j < block; j++)
+		{
+			target[j] = m_First.m_pfData[j] * secondValue;
+		}
+	}
+	return matOut;
+}
+
+MatrixND FactoredMatrixND::materializeSlice(UINT16 dimension, UINT32 index) const
+{
+	return slice(dimension, index).materialize();
+}
+
+FactoredMatrixND FactoredMatrixND::slice(UINT16 dimension, UINT32 index) const
+{
+	FactoredMatrixND result(*this);
+	if (dimension == 0 || dimension > getDimensionality())
+		return result;
+	if (inFirst(dimension))
+		result.m_First = m_First.slice(dimension, index);
+	else
+		result.m_Second = m_Second.slice(dimension - m_First.m_iDimensionality, index);
+	return result;
+}
+
+FactoredMatrixND& FactoredMatrixND::scalarMultiply(float multiple)
+{
+	//Only the smaller operand needs scaling, it is copied first as slices may share it
+	MatrixND& smaller = (m_First.m_iElements <= m_Second.m_iElements) ? m_First : m_Second;
+	MatrixND scaled(smaller);
+	smaller.copy(&scaled);
+	scaled.scalarMultiply(multiple);
+	smaller = scaled;
+	return *this;
+}
+
+float FactoredMatrixND::sum(void) const
+{
+	return m_First.sum() * m_Second.sum();
+}
+
+FactoredMatrixND FactoredMatrixND::sumAlong(UINT16 dimension) const
+{
+	FactoredMatrixND result(*this);
+	if (dimension == 0 || dimension > getDimensionality())
+		return result;
+	if (inFirst(dimension))
+		result.m_First = m_First.sumAlong(dimension);
+	else
+		result.m_Second = m_Second.sumAlong(dimension - m_First.m_iDimensionality);
+	return result;
+}
+
+bool FactoredMatrixND::multiply(MatrixND other, MatrixND* product) const
+{
+	UINT16 da = m_OperatingDimensions.da;
+	UINT16 db = m_OperatingDimensions.db;
+	UINT16 firstDimensionality = m_First.m_iDimensionality;
+	std::vector<UINT32> dimensions = getDimensionVector();
+
+	//Same rules as MatrixND::multipliable
+	if (other.m_iDimensionality != dimensions.size() || db > dimensions.size())
+		return false;
+	if (dimensions.at(db - 1) != other.m_piDimensions[da - 1])
+		return false;
+	for (UINT16 d = 0; d < dimensions.size(); d++)
+	{
+		if (d == da - 1 || d == db - 1)
+			continue;
+		if (dimensions.at(d) != other.m_piDimensions[d])
+			return false;
+	}
+
+	dimensions.at(db - 1) = other.m_piDimensions[db - 1];
+	MatrixND matOut(dimensions);
+	if (inFirst(db))
+	{
+		/*Every block of other over the first operand's dimensions is multiplied by
+		the first operand and scaled by the matching value of the second operand*/
+		UINT32 otherBlock = 1;
+		UINT32 outBlock = 1;
+		for (UINT16 d = 0; d < firstDimensionality; d++)
+		{
+			otherBlock *= other.m_piDimensions[d];
+			outBlock *= dimensions.at(d);
+		}
+		for (UINT32 k = 0; k < m_Second.m_iElements; k++)
+		{
+			MatrixND::multiplyBlock(m_First.m_pfData, m_First.m_piDimensions, m_First.m_piStrides,
+				other.m_pfData + k * otherBlock, other.m_piDimensions, other.m_piStrides,
+				matOut.m_pfData + k * outBlock, matOut.m_piStrides, firstDimensionality, m_OperatingDimensions, m_Second.m_pfData[k]);
+		}
+	}
+	else if (!inFirst(da))
+	{
+		/*The first operand's dimensions are untouched so they are the fastest in
+		both other and the result, each of their fibres starts at one of those elements*/
+		OperatingDimensions_t shifted(da - firstDimensionality, db - firstDimensionality);
+		UINT32 step = m_First.m_iElements;
+		for (UINT32 j = 0; j < step; j++)
+		{
+			MatrixND::multiplyBlock(m_Second.m_pfData, m_Second.m_piDimensions, m_Second.m_piStrides,
+				other.m_pfData + j, other.m_piDimensions + firstDimensionality, other.m_piStrides + firstDimensionality,
+				matOut.m_pfData + j, matOut.m_piStrides + firstDimensionality, m_Second.m_iDimensionality, shifted, m_First.m_pfData[j]);
+		}
+	}
+	else if (matOut.m_iElements != 0)
+	{
+		/*da is in the first operand and db in the second, so every value is the
+		first operand at (r, ...) times the second operand contracted with other.
+		That contraction does not depend on r and is taken once for each position
+		of the first operand's remaining dimensions*/
+		UINT16 p = da - 1;
+		UINT16 q = db - 1 - firstDimensionality;
+		UINT32 n = m_Second.m_piDimensions[q];
+		UINT32 rows = m_First.m_piDimensions[p];
+		UINT32 cols = dimensions.at(db - 1);
+		UINT32 firstStride = m_First.m_piStrides[p];
+		UINT32 secondStride = m_Second.m_piStrides[q];
+		UINT32 firstRest = m_First.m_iElements / rows;
+		UINT32 secondOut = matOut.m_iElements / m_First.m_iElements;
+		//other only differs from the first operand at p where it has n values
+		UINT32 otherBlock = firstRest * n;
+		for (UINT32 j = 0; j < secondOut; j++)
+		{
+			const float* secondFibre = m_Second.m_pfData + j % secondStride + (j / (secondStride * cols)) * secondStride * n;
+			const float* otherBlockData = other.m_pfData + j * otherBlock;
+			float* outBlock = matOut.m_pfData + j * m_First.m_iElements;
+			for (UINT32 a = 0; a < firstRest; a++)
+			{
+				UINT32 low = a % firstStride;
+				UINT32 high = a / firstStride;
+				const float* otherFibre = otherBlockData + low + high * firstStride * n;
+				float sum = 0;
+				for (UINT32 x = 0; x < n; x++)
+				{
+					sum += secondFibre[x * secondStride] * otherFibre[x * firstStride];
+				}
+				UINT32 firstBase = low + high * firstStride * rows;
+				for (UINT32 r = 0; r < rows; r++)
+				{
+					outBlock[firstBase + r * firstStride] = m_First.m_pfData[firstBase + r * firstStride] * sum;
+				}
+			}
+		}
+	}
+	*product = matOut;
+	return true;
+}
+
+bool FactoredMatrixND::multiply(FactoredMatrixND other)
+{
+	UINT16 da = m_OperatingDimensions.da;
+	UINT16 db = m_OperatingDimensions.db;
+	UINT16 firstDimensionality = m_First.m_iDimensionality;
+	if (da == 0 || db > getDimensionality())
+		return false;
+	if (firstDimensionality != other.m_First.m_iDimensionality)
+		return false;
+	if (m_Second.m_iDimensionality != other.m_Second.m_iDimensionality)
+		return false;
+	if (inFirst(da) != inFirst(db))
+		return multiplyStraddling(other);
+
+	//One operand goes through a normal multiply, the other is multiplied elementwise
+	bool firstMultiplied = inFirst(db);
+	MatrixND multiplied = firstMultiplied ? m_First : m_Second;
+	MatrixND multiplier = firstMultiplied ? other.m_First : other.m_Second;
+	MatrixND scaled = firstMultiplied ? m_Second : m_First;
+	MatrixND scaler = firstMultiplied ? other.m_Second : other.m_First;
+	if (firstMultiplied)
+		multiplied.setOperatingDimensions(da, db);
+	else
+		multiplied.setOperatingDimensions(da - firstDimensionality, db - firstDimensionality);
+	if (!multiplied.multipliable(multiplier) || !scaled.compareDimensions(scaler))
+		return false;
+
+	multiplied.multiply(multiplier);
+	MatrixND product(scaled);
+	scaled.copy(&product);
+	for (UINT32 i = 0; i < product.m_iElements; i++)
+	{
+		product.m_pfData[i] *= scaler.m_pfData[i];
+	}
+	m_First = firstMultiplied ? multiplied : product;
+	m_Second = firstMultiplied ? product : multiplied;
+	return true;
+}
+
+void FactoredMatrixND::setOperatingDimensions(UINT16 da, UINT16 db)
+{
+	m_OperatingDimensions.set(da, db);
+}
+
+bool FactoredMatrixND::multiplyStraddling(FactoredMatrixND other)
+{
+	UINT16 p = m_OperatingDimensions.da - 1;
+	UINT16 q = m_OperatingDimensions.db - 1 - m_First.m_iDimensionality;
+	MatrixND& otherFirst = other.m_First;
+	MatrixND& otherSecond = other.m_Second;
+	//Same rules as MatrixND::multipliable applied to the full matrices
+	for (UINT16 d = 0; d < m_First.m_iDimensionality; d++)
+	{
+		UINT32 expected = (d == p) ? m_Second.m_piDimensions[q] : m_First.m_piDimensions[d];
+		if (otherFirst.m_piDimensions[d] != expected)
+			return false;
+	}
+	for (UINT16 d = 0; d < m_Second.m_iDimensionality; d++)
+	{
+		if (d != q && otherSecond.m_piDimensions[d] != m_Second.m_piDimensions[d])
+			return false;
+	}
+
+	/*Like (u vT)(w zT) = (v.w) u zT the two inner operands are contracted with
+	each other. The result only stays rank one when one of them is a vector along
+	its operating dimension, the contraction then scales the other side's operand*/
+	if (m_First.m_iElements == m_First.m_piDimensions[p])
+	{
+		MatrixND second(otherSecond);
+		otherSecond.copy(&second);
+		scaleFibres(second, q + 1, contractFibres(m_Second, q + 1, otherFirst.m_pfData));
+		m_Second = second;
+		return true;
+	}
+	if (m_Second.m_iElements == m_Second.m_piDimensions[q])
+	{
+		MatrixND first(m_First);
+		m_First.copy(&first);
+		scaleFibres(first, p + 1, contractFibres(otherFirst, p + 1, m_Second.m_pfData));
+		m_First = first;
+		m_Second = otherSecond;
+		return true;
+	}
+	return false;
+}
+
+MatrixND FactoredMatrixND::contractFibres(const MatrixND& matrix, UINT16 dimension, const float* vector)
+{
+	std::vector<UINT32> dimensions(matrix.m_piDimensions, matrix.m_piDimensions + matrix.m_iDimensionality);
+	dimensions.at(dimension - 1) = 1;
+	MatrixND matOut(dimensions);
+	//Same indexing as MatrixND::sumAlong with each value weighted by its place along the dimension
+	UINT32 inner = matrix.m_piStrides[dimension - 1];
+	UINT32 span = inner * matrix.m_piDimensions[dimension - 1];
+	for (UINT32 i = 0; i < matrix.m_iElements; i++)
+	{
+		matOut.m_pfData[(i % inner) + (i / span) * inner] += matrix.m_pfData[i] * vector[(i / inner) % matrix.m_piDimensions[dimension - 1]];
+	}
+	return matOut;
+}
+
+void FactoredMatrixND::scaleFibres(MatrixND& target, UINT16 dimension, const MatrixND& factors)
+{
+	UINT32 inner = target.m_piStrides[dimension - 1];
+	UINT32 span = inner * target.m_piDimensions[dimension - 1];
+	for (UINT32 i = 0; i < target.m_iElements; i++)
+	{
+		target.m_pfData[i] *= factors.m_pfData[(i % inner) + (i / span) * inner];
+	}
+}
+
+std::vector<UINT32> FactoredMatrixND::getDimensionVector(void) const
+{
+	std::vector<UINT32> dimensions(m_First.m_piDimensions, m_First.m_piDimensions + m_First.m_iDimensionality);
+	dimensions.insert(dimensions.end(), m_Second.m_piDimensions, m_Second.m_piDimensions + m_Second.m_iDimensionality);
+	return dimensions;
+}
+
+//-------Starting point for methods of class LiveProductND--------
+LiveProductND::LiveProductND(MatrixND left, MatrixND right, UINT16 batchDimension)
+	: m_Left(left), m_Right(right), m_Product(left)
+{
+	//The operands are copied so only changes made through this class are seen
+	left.copy(&m_Left);
+	right.copy(&m_Right);
+	m_OperatingDimensions = left.m_OperatingDimensions;
+	m_bMultipliable = m_Left.multipliable(m_Right);
+
+	m_iBatchDimension = batchDimension;
+	if (!m_bMultipliable || batchDimension == 0 || !m_Left.dimensionExists(batchDimension)
+		|| batchDimension == m_OperatingDimensions.da || batchDimension == m_OperatingDimensions.db)
+		m_iBatchDimension = 0;
+	UINT32 slices = m_iBatchDimension ? m_Left.m_piDimensions[m_iBatchDimension - 1] : 1;
+	m_DirtySlices.assign(slices, false);
+
+	//Like MatrixND::multiply the product is left as a copy of left when it cannot be taken
+	m_Left.copy(&m_Product);
+	if (m_bMultipliable)
+		m_Product.multiply(m_Right);
+}
+
+float& LiveProductND::leftAt(const std::vector<UINT32>& position)
+{
+	UINT32 offset;
+	if (getPlaneOffset(m_Left, position, &offset))
+		markDirty(getSliceFromPosition(position));
+	return m_Left.at(position);
+}
+
+float& LiveProductND::rightAt(const std::vector<UINT32>& position)
+{
+	UINT32 offset;
+	if (getPlaneOffset(m_Right, position, &offset))
+		markDirty(getSliceFromPosition(position));
+	return m_Right.at(position);
+}
+
+void LiveProductND::setLeftSlice(UINT32 index, MatrixND slice)
+{
+	setSlice(m_Left, index, slice);
+}
+
+void LiveProductND::setRightSlice(UINT32 index, MatrixND slice)
+{
+	setSlice(m_Right, index, slice);
+}
+
+void LiveProductND::markDirty(UINT32 index)
+{
+	if (index >= 1 && index <= m_DirtySlices.size())
+		m_DirtySlices.at(index - 1) = true;
+}
+
+void LiveProductND::updateLeft(const std::vector<UINT32>& position, MatrixND u, MatrixND v)
+{
+	if (!m_bMultipliable)
+		return;
+	UINT32 leftBase, rightBase, productBase;
+	if (!getPlaneOffset(m_Left, position, &leftBase))
+		return;
+	getPlaneOffset(m_Right, position, &rightBase);
+	getPlaneOffset(m_Product, position, &productBase);
+	UINT16 p = m_OperatingDimensions.da - 1;
+	UINT16 q = m_OperatingDimensions.db - 1;
+	UINT32 rows = m_Left.m_piDimensions[p];
+	UINT32 n = m_Left.m_piDimensions[q];
+	UINT32 cols = m_Right.m_piDimensions[q];
+	if (!validUpdate(rows, n, u, v))
+		return;
+	UINT32 rank = u.m_piDimensions[1];
+	const UINT32* leftStrides = m_Left.m_piStrides;
+	const UINT32* rightStrides = m_Right.m_piStrides;
+	const UINT32* productStrides = m_Product.m_piStrides;
+
+	for (UINT32 j = 0; j < rank; j++)
+	{
+		for (UINT32 x = 0; x < n; x++)
+		{
+			float vValue = v.m_pfData[x + j * n];
+			for (UINT32 r = 0; r < rows; r++)
+			{
+				m_Left.m_pfData[leftBase + r * leftStrides[p] + x * leftStrides[q]] += u.m_pfData[r + j * rows] * vValue;
+			}
+		}
+	}
+	//A dirty slice is recomputed in full on the next refresh anyway
+	if (m_DirtySlices.at(getSliceFromPosition(position) - 1))
+		return;
+
+	//The product plane changes by u times v transposed times the right plane
+	std::vector<float> w(rank * cols, 0.0f);
+	for (UINT32 j = 0; j < rank; j++)
+	{
+		for (UINT32 c = 0; c < cols; c++)
+		{
+			float sum = 0;
+			for (UINT32 x = 0; x < n; x++)
+			{
+				sum += v.m_pfData[x + j * n] * m_Right.m_pfData[rightBase + x * rightStrides[p] + c * rightStrides[q]];
+			}
+			w[j + c * rank] = sum;
+		}
+	}
+	for (UINT32 r = 0; r < rows; r++)
+	{
+		for (UINT32 c = 0; c < cols; c++)
+		{
+			float sum = 0;
+			for (UINT32 j = 0; j < rank; j++)
+			{
+				sum += u.m_pfData[r + j * rows] * w[j + c * rank];
+			}
+			m_Product.m_pfData[productBase + r * productStrides[p] + c * productStrides[q]] += sum;
+		}
+	}
+}
+
+void LiveProductND::updateRight(const std::vector<UINT32>& position, MatrixND u, MatrixND v)
+{
+	if (!m_bMultipliable)
+		return;
+	UINT32 leftBase, rightBase, productBase;
+	if (!getPlaneOffset(m_Right, position, &rightBase))
+		return;
+	getPlaneOffset(m_Left, position, &leftBase);
+	getPlaneOffset(m_Product, position, &productBase);
+	UINT16 p = m_OperatingDimensions.da - 1;
+	UINT16 q = m_OperatingDimensions.db - 1;
+	UINT32 rows = m_Left.m_piDimensions[p];
+	UINT32 n = m_Right.m_piDimensions[p];
+	UINT32 cols = m_Right.m_piDimensions[q];
+	if (!validUpdate(n, cols, u, v))
+		return;
+	UINT32 rank = u.m_piDimensions[1];
+	const UINT32* leftStrides = m_Left.m_piStrides;
+	const UINT32* rightStrides = m_Right.m_piStrides;
+	const UINT32* productStrides = m_Product.m_piStrides;
+
+	for (UINT32 j = 0; j < rank; j++)
+	{
+		for (UINT32 c = 0; c < cols; c++)
+		{
+			float vValue = v.m_pfData[c + j * cols];
+			for (UINT32 x = 0; x < n; x++)
+			{
+				m_Right.m_pfData[rightBase + x * rightStrides[p] + c * rightStrides[q]] += u.m_pfData[x + j * n] * vValue;
+			}
+		}
+	}
+	if (m_DirtySlices.at(getSliceFromPosition(position) - 1))
+		return;
+
+	//The product plane changes by the left plane times u times v transposed
+	std::vector<float> w(rows * rank, 0.0f);
+	for (UINT32 j = 0; j < rank; j++)
+	{
+		for (UINT32 r = 0; r < rows; r++)
+		{
+			float sum = 0;
+			for (UINT32 x = 0; x < n; x++)
+			{
+				sum += m_Left.m_pfData[leftBase + r * leftStrides[p] + x * leftStrides[q]] * u.m_pfData[x + j * n];
+			}
+			w[r + j * rows] = sum;
+		}
+	}
+	for (UINT32 c = 0; c < cols; c++)
+	{
+		for (UINT32 r = 0; r < rows; r++)
+		{
+			float sum = 0;
+			for (UINT32 j = 0; j < rank; j++)
+			{
+				sum += w[r + j * rows] * v.m_pfData[c + j * cols];
+			}
+			m_Product.m_pfData[productBase + r * productStrides[p] + c * productStrides[q]] += sum;
+		}
+	}
+}
+
+const MatrixND& LiveProductND::refresh(void)
+{
+	for (UINT32 i = 0; i < m_DirtySlices.size(); i++)
+	{
+		if (m_DirtySlices.at(i))
+		{
+			recomputeSlice(i + 1);
+			m_DirtySlices.at(i) = false;
+		}
+	}
+	return m_Product;
+}
+
+UINT32 LiveProductND::getSliceFromPosition(const std::vector<UINT32>& position) const
+{
+	if (m_iBatchDimension == 0)
+		return 1;
+	return position.at(m_iBatchDimension - 1);
+}
+
+void LiveProductND::setSlice(MatrixND& target, UINT32 index, MatrixND slice)
+{
+	if (index == 0 || index > m_DirtySlices.size())
+		return;
+	if (slice.m_iDimensionality != target.m_iDimensionality)
+		return;
+	for (UINT16 d = 0; d < target.m_iDimensionality; d++)
+	{
+		UINT32 expected = (d == m_iBatchDimension - 1) ? 1 : target.m_piDimensions[d];
+		if (slice.m_piDimensions[d] != expected)
+			return;
+	}
+	markDirty(index);
+	if (target.m_iElements == 0)
+		return;
+
+	//Same runs as MatrixND::slice but copied the other way
+	UINT32 inner = m_iBatchDimension ? target.m_piStrides[m_iBatchDimension - 1] : target.m_iElements;
+	UINT32 n = m_iBatchDimension ? target.m_piDimensions[m_iBatchDimension - 1] : 1;
+	UINT32 outer = target.m_iElements / (inner * n);
+	for (UINT32 o = 0; o < outer; o++)
+	{
+		memcpy(target.m_pfData + (o * n + index - 1) * inner,
+			slice.m_pfData + o * inner,
+			sizeof(float) * inner);
+	}
+}
+
+bool LiveProductND::getPlaneOffset(const MatrixND& matrix, const std::vector<UINT32>& position, UINT32* offset) const
+{
+	if (position.size() != matrix.m_iDimensionality)
+		return false;
+	*offset = 0;
+	for (UINT16 d = 0; d < matrix.m_iDimensionality; d++)
+	{
+		if (d == m_OperatingDimensions.da - 1 || d == m_OperatingDimensions.db - 1)
+			continue;
+		if (position.at(d) == 0 || position.at(d) > matrix.m_piDimensions[d])
+			return false;
+		*offset += (position.at(d) - 1) * matrix.m_piStrides[d];
+	}
+	return true;
+}
+
+bool LiveProductND::validUpdate(UINT32 rows, UINT32 cols, MatrixND u, MatrixND v) const
+{
+	if (u.m_iDimensionality != 2 || v.m_iDimensionality != 2)
+		return false;
+	return u.m_piDimensions[0] == rows && v.m_piDimensions[0] == cols && u.m_piDimensions[1] == v.m_piDimensions[1];
+}
+
+void LiveProductND::recomputeSlice(UINT32 index)
+{
+	if (!m_bMultipliable)
+		return;
+	if (m_iBatchDimension == 0)
+	{
+		MatrixND::multiplyBlock(m_Left.m_pfData, m_Left.m_piDimensions, m_Left.m_piStrides,
+			m_Right.m_pfData, m_Right.m_piDimensions, m_Right.m_piStrides,
+			m_Product.m_pfData, m_Product.m_piStrides, m_Left.m_iDimensionality, m_OperatingDimensions, 1.0f);
+		return;
+	}
+	//The slice is the full operands with the batch dimension cut down to one value
+	UINT16 batch = m_iBatchDimension - 1;
+	std::vector<UINT32> leftDimensions(m_Left.m_piDimensions, m_Left.m_piDimensions + m_Left.m_iDimensionality);
+	std::vector<UINT32> rightDimensions(m_Right.m_piDimensions, m_Right.m_piDimensions + m_Right.m_iDimensionality);
+	leftDimensions.at(batch) = 1;
+	rightDimensions.at(batch) = 1;
+	UINT32 k = index - 1;
+	MatrixND::multiplyBlock(m_Left.m_pfData + k * m_Left.m_piStrides[batch], &leftDimensions[0], m_Left.m_piStrides,
+		m_Right.m_pfData + k * m_Right.m_piStrides[batch], &rightDimensions[0], m_Right.m_piStrides,
+		m_Product.m_pfData + k * m_Product.m_piStrides[batch], m_Product.m_piStrides,
+		m_Left.m_iDimensionality, m_OperatingDimensions, 1.0f);
+}
+
+//-------Starting point for methods of class CachedMatrixND-------
+CachedMatrixND::CachedMatrixND(std::shared_ptr<const MatrixND> matrix)
+	: m_spMatrix(matrix)
+{
+}
+
+float CachedMatrixND::at(UINT32 index) const
+{
+	if (index < m_spMatrix->m_iElements)
+		return m_spMatrix->m_pfData[index];
+	return 0.0f;
+}
+
+float CachedMatrixND::at(const std::vector<UINT32>& position) const
+{
+	if (!m_spMatrix->isInMatrix(position))
+		return 0.0f;
+	for (UINT16 i = 0; i < position.size(); i++)
+	{
+		if (position.at(i) == 0)
+			return 0.0f;
+	}
+	return m_spMatrix->m_pfData[m_spMatrix->getIndexFromPosition(position)];
+}
+
+MatrixND CachedMatrixND::toMatrix(void) const
+{
+	const MatrixND& cached = *m_spMatrix;
+	MatrixND matOut(std::vector<UINT32>(cached.m_piDimensions, cached.m_piDimensions + cached.m_iDimensionality));
+	memcpy(matOut.m_pfData, cached.m_pfData, sizeof(float) * cached.m_iElements);
+	matOut.m_OperatingDimensions = cached.m_OperatingDimensions;
+	return matOut;
+}
+
+bool CachedMatrixND::equals(MatrixND other) const
+{
+	return m_spMatrix->equals(other);
+}
+
+//-------Starting point for methods of class MatrixNDCache--------
+bool MatrixNDCache::Operand_t::operator<(const Operand_t& other) const
+{
+	if (hash != other.hash)
+		return hash < other.hash;
+	if (check != other.check)
+		return check < other.check;
+	return dimensions < other.dimensions;
+}
+
+bool MatrixNDCache::Key_t::operator<(const Key_t& other) const
+{
+	if (operation != other.operation)
+		return operation < other.operation;
+	if (da != other.da)
+		return da < other.da;
+	if (db != other.db)
+		return db < other.db;
+	if (first < other.first || other.first < first)
+		return first < other.first;
+	return second < other.second;
+}
+
+MatrixNDCache::MatrixNDCache(size_t capacityBytes)
+{
+	m_iCapacity = capacityBytes;
+	m_iBytes = 0;
+	m_iHits = 0;
+	m_iMisses = 0;
+}
+
+CachedMatrixND MatrixNDCache::generateIdentity(std::vector<UINT32>& dimensions, OperatingDimensions_t dims)
+{
+	//Identities only depend on their shape so no values are hashed
+	Key_t key = { OPERATION_IDENTITY, dims.da, dims.db, Operand_t(), Operand_t() };
+	key.first.dimensions = dimensions;
+	std::shared_ptr<const MatrixND> result = find(key);
+	if (result)
+		return CachedMatrixND(result);
+	return CachedMatrixND(insert(key, share(MatrixND::generateIdentity(dimensions, dims), NULL)));
+}
+
+CachedMatrixND MatrixNDCache::transpose(MatrixND matIn, OperatingDimensions_t dims)
+{
+	Key_t key = { OPERATION_TRANSPOSE, dims.da, dims.db, describe(matIn), Operand_t() };
+	std::shared_ptr<const MatrixND> result = find(key);
+	if (result)
+		return CachedMatrixND(result);
+	return CachedMatrixND(insert(key, share(MatrixND::transpose(matIn, dims), matIn.getData())));
+}
+
+CachedMatrixND MatrixNDCache::multiply(MatrixND left, MatrixND right)
+{
+	OperatingDimensions_t dims = left.getOperatingDimensions();
+	Key_t key = { OPERATION_MULTIPLY, dims.da, dims.db, describe(left), describe(right) };
+	std::shared_ptr<const MatrixND> result = find(key);
+	if (result)
+		return CachedMatrixND(result);
+	MatrixND product(left);
+	product.multiply(right);
+	return CachedMatrixND(insert(key, share(product, left.getData())));
+}
+
+void MatrixNDCache::clear(void)
+{
+	m_Entries.clear();
+	m_Index.clear();
+	m_iBytes = 0;
+}
+
+void MatrixNDCache::setCapacity(size_t capacityBytes)
+{
+	m_iCapacity = capacityBytes;
+	evict(0);
+}
+
+double MatrixNDCache::getHitRate(void) const
+{
+	if (m_iHits + m_iMisses == 0)
+		return 0.0;
+	return (double)m_iHits / (double)(m_iHits + m_iMisses);
+}
+
+std::shared_ptr<const MatrixND> MatrixNDCache::find(const Key_t& key)
+{
+	std::map<Key_t, std::list<Entry_t>::iterator>::iterator found = m_Index.find(key);
+	if (found == m_Index.end())
+	{
+		m_iMisses++;
+		return std::shared_ptr<const MatrixND>();
+	}
+	m_iHits++;
+	//Moves the entry to the front as the most recently used
+	m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+	return found->second->result;
+}
+
+std::shared_ptr<const MatrixND> MatrixNDCache::insert(const Key_t& key, std::shared_ptr<const MatrixND> result)
+{
+	size_t bytes = sizeof(float) * result->getElements();
+	//Results that can never fit are handed back without being kept
+	if (bytes > m_iCapacity)
+		return result;
+	evict(bytes);
+	Entry_t entry = { key, result, bytes };
+	m_Entries.push_front(entry);
+	m_Index[key] = m_Entries.begin();
+	m_iBytes += bytes;
+	return result;
+}
+
+void MatrixNDCache::evict(size_t incoming)
+{
+	while (!m_Entries.empty() && m_iBytes + incoming > m_iCapacity)
+	{
+		m_iBytes -= m_Entries.back().bytes;
+		m_Index.erase(m_Entries.back().key);
+		m_Entries.pop_back();
+	}
+}
+
+std::shared_ptr<const MatrixND> MatrixNDCache::share(MatrixND result, const float* input)
+{
+	//Failed operations hand back their input which the cache must not take over
+	if (result.getData() == input)
+	{
+		MatrixND copy(result);
+		result.copy(&copy);
+		result = copy;
+	}
+	//The result's storage is adopted so it is freed once evicted and no longer used
+	std::vector<UINT32> dimensions(result.getDimensions(), result.getDimensions() + result.getDimensionality());
+	MatrixND* shared = new MatrixND(result.getData(), dimensions, [](float* data){ delete[] data; });
+	shared->setOperatingDimensions(result.getOperatingDimensions().da, result.getOperatingDimensions().db);
+	return std::shared_ptr<const MatrixND>(shared);
+}
+
+MatrixNDCache::Operand_t MatrixNDCache::describe(const MatrixND& matrix)
+{
+	Operand_t operand;
+	operand.dimensions.assign(matrix.getDimensions(), matrix.getDimensions() + matrix.getDimensionality());
+	operand.hash = matrix.contentHash();
+	operand.check = checkHash(matrix);
+	return operand;
+}
+
+uint64_t MatrixNDCache::checkHash(const MatrixND& matrix)
+{
+	//Multiply and rotate mixing in the style of MurmurHash, seeded with the element count
+	const float* data = matrix.getData();
+	uint64_t hash = 0x27d4eb2f165667c5ULL ^ matrix.getElements();
+	UINT32 word;
+	float value;
+	for (UINT32 i = 0; i < matrix.getElements(); i++)
+	{
+		//-0 and +0 hash the same as in MatrixND::contentHash
+		value = data[i] + 0.0f;
+		memcpy(&word, &value, sizeof(UINT32));
+		uint64_t mixed = word * 0x87c37b91114253d5ULL;
+		mixed = (mixed << 31) | (mixed >> 33);
+		hash ^= mixed * 0x4cf5ad432745937fULL;
+		hash = ((hash << 27) | (hash >> 37)) * 5 + 0x52dce729;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
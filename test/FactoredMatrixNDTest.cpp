@@ -0,0 +1,231 @@
+/*****************************************Comment**********************************************
+*Tests for FactoredMatrixND
+*Purpose:  To check every factored operation against the same operation on the built matrix
+*Build: g++ -std=c++11 -I../src ../src/MatrixND.cpp FactoredMatrixNDTest.cpp -o FactoredMatrixNDTest
+*Returns zero when every check passes
+****************************************End Comment********************************************/
+#include "MatrixND.h"
+#include <cstdio>
+#include <cmath>
+
+static int failures = 0;
+
+static void check(bool condition, const char* name, int detail = -1)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s %d\n", name, detail);
+		failures++;
+	}
+}
+
+static MatrixND makeMatrix(std::vector<UINT32> dimensions, UINT32 seed)
+{
+	MatrixND matrix(dimensions);
+	for (UINT32 i = 0; i < matrix.getElements(); i++)
+	{
+		matrix.at(i) = (float)((i * 7 + seed * 3) % 11) - 5.0f;
+	}
+	return matrix;
+}
+
+static std::vector<UINT32> dimensionsOf(MatrixND matrix)
+{
+	return std::vector<UINT32>(matrix.getDimensions(), matrix.getDimensions() + matrix.getDimensionality());
+}
+
+static bool same(MatrixND a, MatrixND b)
+{
+	if (dimensionsOf(a) != dimensionsOf(b))
+		return false;
+	for (UINT32 i = 0; i < a.getElements(); i++)
+	{
+		if (fabs(a.at(i) - b.at(i)) > 1e-3f)
+			return false;
+	}
+	return true;
+}
+
+//The product of the built matrix, which every factored product must match
+static MatrixND reference(const FactoredMatrixND& factored, MatrixND other)
+{
+	MatrixND full = factored.materialize();
+	full.setOperatingDimensions(factored.getOperatingDimensions().da, factored.getOperatingDimensions().db);
+	return full.multiply(other);
+}
+
+//A matrix other can be multiplied by: matching everywhere but da, which takes db's extent, and db
+static MatrixND makeOther(std::vector<UINT32> dimensions, UINT16 da, UINT16 db, UINT32 columns, UINT32 seed)
+{
+	dimensions.at(da - 1) = dimensions.at(db - 1);
+	dimensions.at(db - 1) = columns;
+	return makeMatrix(dimensions, seed);
+}
+
+static void testMatrixMultiply(void)
+{
+	//The result takes db's extent from other
+	std::vector<UINT32> aDimensions(2, 2);
+	aDimensions.at(1) = 3;
+	std::vector<UINT32> bDimensions(2, 3);
+	bDimensions.at(1) = 4;
+	MatrixND a = makeMatrix(aDimensions, 1);
+	MatrixND b = makeMatrix(bDimensions, 2);
+	MatrixND product = makeMatrix(aDimensions, 1);
+	product.multiply(b);
+	check(product.getDimensions()[0] == 2 && product.getDimensions()[1] == 4, "multiply result shape");
+	bool values = true;
+	for (UINT32 r = 1; r <= 2; r++)
+	{
+		for (UINT32 c = 1; c <= 4; c++)
+		{
+			float sum = 0;
+			for (UINT32 x = 1; x <= 3; x++)
+			{
+				std::vector<UINT32> aPosition(2, r);
+				aPosition.at(1) = x;
+				std::vector<UINT32> bPosition(2, x);
+				bPosition.at(1) = c;
+				sum += a.at(aPosition) * b.at(bPosition);
+			}
+			std::vector<UINT32> position(2, r);
+			position.at(1) = c;
+			values = values && product.at(position) == sum;
+		}
+	}
+	check(values, "multiply result values");
+}
+
+static void testElementwise(void)
+{
+	std::vector<UINT32> firstDimensions(2, 2);
+	firstDimensions.at(1) = 3;
+	std::vector<UINT32> secondDimensions(2, 3);
+	MatrixND first = makeMatrix(firstDimensions, 1);
+	FactoredMatrixND factored = first.factoredOuterProduct(makeMatrix(secondDimensions, 2));
+	MatrixND full = factored.materialize();
+
+	MatrixND outer = makeMatrix(firstDimensions, 1);
+	outer.outerProduct(makeMatrix(secondDimensions, 2));
+	check(same(outer, full), "outerProduct");
+
+	std::vector<UINT32> position(4, 2);
+	position.at(1) = 3;
+	check(factored.at(position) == full.at(position), "at");
+	check(fabs(factored.sum() - full.sum()) < 1e-3f, "sum");
+	for (UINT16 d = 1; d <= 4; d++)
+	{
+		check(same(factored.sumAlong(d).materialize(), full.sumAlong(d)), "sumAlong", d);
+		check(same(factored.materializeSlice(d, 2), full.slice(d, 2)), "slice", d);
+	}
+
+	//Scaling a factored matrix must not reach the matrices it was sliced from
+	FactoredMatrixND scaled = factored.slice(1, 1);
+	scaled.scalarMultiply(3.0f);
+	MatrixND expected = full.slice(1, 1);
+	expected *= 3.0f;
+	check(same(scaled.materialize(), expected), "scalarMultiply");
+	check(same(factored.materialize(), full), "scalarMultiply leaves the original");
+}
+
+static void testFactoredByMatrix(void)
+{
+	//Both operating dimensions in the first operand, in the second, and straddling the two
+	std::vector<UINT32> firstDimensions(3, 2);
+	firstDimensions.at(1) = 3;
+	std::vector<UINT32> secondDimensions(2, 3);
+	secondDimensions.at(1) = 2;
+	FactoredMatrixND factored = makeMatrix(firstDimensions, 1).factoredOuterProduct(makeMatrix(secondDimensions, 2));
+	std::vector<UINT32> dimensions = dimensionsOf(factored.materialize());
+	for (UINT16 da = 1; da <= 5; da++)
+	{
+		for (UINT16 db = da + 1; db <= 5; db++)
+		{
+			factored.setOperatingDimensions(da, db);
+			MatrixND other = makeOther(dimensions, da, db, 4, da * 5 + db);
+			MatrixND product(std::vector<UINT32>(1, 1));
+			bool multiplied = factored.multiply(other, &product);
+			check(multiplied && same(product, reference(factored, other)), "factored by matrix", da * 10 + db);
+		}
+	}
+
+	//Not multipliable leaves the product alone
+	factored.setOperatingDimensions(1, 4);
+	MatrixND product(std::vector<UINT32>(1, 1));
+	check(!factored.multiply(makeMatrix(dimensions, 3), &product) && product.getElements() == 1, "factored by matrix refused");
+}
+
+static void testFactoredByFactored(void)
+{
+	std::vector<UINT32> three(1, 3);
+	std::vector<UINT32> four(1, 4);
+	std::vector<UINT32> five(1, 5);
+	std::vector<UINT32> threeByTwo(2, 3);
+	threeByTwo.at(1) = 2;
+	std::vector<UINT32> fourByTwo(2, 4);
+	fourByTwo.at(1) = 2;
+	std::vector<UINT32> fiveByTwo(2, 5);
+	fiveByTwo.at(1) = 2;
+	std::vector<UINT32> twoByThree(2, 2);
+	twoByThree.at(1) = 3;
+	std::vector<UINT32> twoByFour(2, 2);
+	twoByFour.at(1) = 4;
+
+	struct Case_t
+	{
+		std::vector<UINT32> a, b, c, d;
+		UINT16 da, db;
+		bool expected;
+		const char* name;
+	};
+	Case_t cases[] =
+	{
+		//Operating dimensions inside the first operand
+		{ twoByThree, four, threeByTwo, four, 1, 2, true, "inside first" },
+		//Inside the second operand
+		{ three, twoByThree, three, threeByTwo, 2, 3, true, "inside second" },
+		//u vT times w zT
+		{ three, four, four, five, 1, 2, true, "vector straddle" },
+		//First operand a vector along da
+		{ three, fourByTwo, four, fiveByTwo, 1, 2, true, "first vector straddle" },
+		//Second operand a vector along db
+		{ threeByTwo, four, fourByTwo, five, 1, 3, true, "second vector straddle" },
+		//Neither inner operand is a vector so the product is not rank one
+		{ threeByTwo, fourByTwo, fourByTwo, fiveByTwo, 1, 3, false, "refused straddle" },
+		//Not multipliable
+		{ three, four, three, five, 1, 2, false, "not multipliable" },
+		//db beyond the matrix
+		{ three, three, three, three, 1, 9, false, "out of range" }
+	};
+	for (UINT32 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		const Case_t& test = cases[i];
+		FactoredMatrixND left = makeMatrix(test.a, 1).factoredOuterProduct(makeMatrix(test.b, 2));
+		FactoredMatrixND right = makeMatrix(test.c, 3).factoredOuterProduct(makeMatrix(test.d, 4));
+		left.setOperatingDimensions(test.da, test.db);
+		MatrixND before = left.materialize();
+		bool multiplied = left.multiply(right);
+		check(multiplied == test.expected, test.name);
+		if (multiplied)
+		{
+			before.setOperatingDimensions(test.da, test.db);
+			check(same(left.materialize(), before.multiply(right.materialize())), test.name);
+		}
+		else
+		{
+			check(same(left.materialize(), before), test.name);
+		}
+	}
+}
+
+int main()
+{
+	testMatrixMultiply();
+	testElementwise();
+	testFactoredByMatrix();
+	testFactoredByFactored();
+
+	if (failures == 0)
+		printf("All FactoredMatrixND checks passed\n");
+	return failures;
+}
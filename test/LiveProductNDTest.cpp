@@ -0,0 +1,124 @@
+/*****************************************Comment**********************************************
+*Tests for LiveProductND
+*Purpose:  To make sure incremental refreshes and rank k updates match a full multiply
+*Build: g++ -std=c++11 -I../src ../src/MatrixND.cpp LiveProductNDTest.cpp -o LiveProductNDTest
+*Returns zero when every check passes
+****************************************End Comment********************************************/
+#include "MatrixND.h"
+#include <cstdio>
+#include <cmath>
+
+static int failures = 0;
+
+static void check(bool condition, const char* name, int detail)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s %d\n", name, detail);
+		failures++;
+	}
+}
+
+static MatrixND makeMatrix(std::vector<UINT32> dimensions, UINT32 seed)
+{
+	MatrixND matrix(dimensions);
+	for (UINT32 i = 0; i < matrix.getElements(); i++)
+	{
+		matrix.at(i) = (float)((i * 5 + seed * 3) % 9) - 4.0f;
+	}
+	return matrix;
+}
+
+//The product has to match a full multiply of the operands as they are now
+static bool matchesFull(const LiveProductND& live)
+{
+	MatrixND left = live.getLeft();
+	MatrixND product = left.multiply(live.getRight());
+	const MatrixND& kept = live.getProduct();
+	if (product.getElements() != kept.getElements())
+		return false;
+	for (UINT32 i = 0; i < product.getElements(); i++)
+	{
+		if (fabs(product.at(i) - kept.getData()[i]) > 1e-3f)
+			return false;
+	}
+	return true;
+}
+
+//A position inside the operating plane of the given batch slice
+static std::vector<UINT32> planePosition(UINT16 batch, UINT32 slice)
+{
+	std::vector<UINT32> position(4, 1);
+	position.at(batch - 1) = slice;
+	return position;
+}
+
+static void testLayout(UINT16 batch, UINT16 da, UINT16 db)
+{
+	//Four dimensions with the batch dimension holding three slices
+	std::vector<UINT32> leftDimensions(4, 2);
+	leftDimensions.at(batch - 1) = 3;
+	leftDimensions.at(da - 1) = 3;
+	leftDimensions.at(db - 1) = 4;
+	std::vector<UINT32> rightDimensions = leftDimensions;
+	rightDimensions.at(da - 1) = 4;
+	rightDimensions.at(db - 1) = 5;
+	MatrixND left = makeMatrix(leftDimensions, 1);
+	left.setOperatingDimensions(da, db);
+	LiveProductND live(left, makeMatrix(rightDimensions, 2), batch);
+	check(live.getBatchDimension() == batch, "batch dimension kept", batch);
+	check(matchesFull(live), "initial product", batch);
+
+	MatrixND leftU = makeMatrix(std::vector<UINT32>{ 3, 2 }, 3);
+	MatrixND leftV = makeMatrix(std::vector<UINT32>{ 4, 2 }, 4);
+	MatrixND rightU = makeMatrix(std::vector<UINT32>{ 4, 2 }, 5);
+	MatrixND rightV = makeMatrix(std::vector<UINT32>{ 5, 2 }, 6);
+
+	//Rank k updates on a clean slice go straight into the product
+	live.updateLeft(planePosition(batch, 1), leftU, leftV);
+	check(matchesFull(live), "updateLeft on a clean slice", batch);
+	live.updateRight(planePosition(batch, 3), rightU, rightV);
+	check(matchesFull(live), "updateRight on a clean slice", batch);
+
+	//A write marks its slice dirty, updates on that slice then wait for refresh
+	std::vector<UINT32> written = planePosition(batch, 2);
+	written.at(da - 1) = 2;
+	live.leftAt(written) = 7.0f;
+	live.updateRight(planePosition(batch, 2), rightU, rightV);
+	live.updateLeft(planePosition(batch, 2), leftU, leftV);
+	live.refresh();
+	check(matchesFull(live), "updates on a dirty slice", batch);
+
+	//Writes to the right operand and whole slices of the left one
+	std::vector<UINT32> rightWritten = planePosition(batch, 3);
+	rightWritten.at(db - 1) = 5;
+	live.rightAt(rightWritten) = -6.0f;
+	std::vector<UINT32> sliceDimensions = leftDimensions;
+	sliceDimensions.at(batch - 1) = 1;
+	live.setLeftSlice(1, makeMatrix(sliceDimensions, 8));
+	live.refresh();
+	check(matchesFull(live), "rightAt and setLeftSlice", batch);
+
+	//Only the dirty slices are recomputed, a clean update afterwards still lands
+	live.updateLeft(planePosition(batch, 3), leftU, leftV);
+	check(matchesFull(live), "update after refresh", batch);
+
+	//Another slice being dirty must not stop a clean slice's update reaching the product
+	live.leftAt(planePosition(batch, 1)) = 3.0f;
+	live.updateLeft(planePosition(batch, 3), leftU, leftV);
+	live.updateRight(planePosition(batch, 2), rightU, rightV);
+	live.refresh();
+	check(matchesFull(live), "clean updates beside a dirty slice", batch);
+}
+
+int main()
+{
+	//Batch dimension before the operating dimensions
+	testLayout(1, 2, 4);
+	//And after them
+	testLayout(3, 1, 2);
+
+	if (failures == 0)
+		printf("All LiveProductND checks passed\n");
+	return failures;
+}
@@ -0,0 +1,153 @@
+/*****************************************Comment**********************************************
+*Tests for wrapping external buffers and DLPack export
+*Purpose:  To make sure C order buffers are shared in place and strided ones are gathered
+*Build: g++ -std=c++11 -I../src ../src/MatrixND.cpp MatrixNDBufferTest.cpp -o MatrixNDBufferTest
+*Returns zero when every check passes
+****************************************End Comment********************************************/
+#include "MatrixND.h"
+#include <cstdio>
+
+static int failures = 0;
+static int freedBuffers = 0;
+static int freedTensors = 0;
+
+static void check(bool condition, const char* name)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", name);
+		failures++;
+	}
+}
+
+static void countBuffer(float* data)
+{
+	delete[] data;
+	freedBuffers++;
+}
+
+static void countTensor(MatrixND_DLManagedTensor* tensor)
+{
+	(void)tensor;
+	freedTensors++;
+}
+
+//A C order (2, 3, 4) buffer where the value is the offset
+static float* makeRowMajor(void)
+{
+	float* data = new float[24];
+	for (UINT32 i = 0; i < 24; i++)
+	{
+		data[i] = (float)i;
+	}
+	return data;
+}
+
+static std::vector<UINT32> position(UINT32 c, UINT32 b, UINT32 a)
+{
+	std::vector<UINT32> pos(3, c);
+	pos.at(1) = b;
+	pos.at(2) = a;
+	return pos;
+}
+
+static void testRowMajorInPlace(void)
+{
+	//Shape (a, b, c) = (2, 3, 4) is wrapped as {c, b, a}
+	std::vector<UINT32> dimensions(3, 4);
+	dimensions.at(1) = 3;
+	dimensions.at(2) = 2;
+	std::vector<UINT32> strides(3, 1);
+	strides.at(1) = 4;
+	strides.at(2) = 12;
+	float* data = makeRowMajor();
+	freedBuffers = 0;
+	{
+		MatrixND matrix(data, dimensions, strides, countBuffer);
+		check(matrix.getData() == data, "row major buffer used in place");
+		//Element [1][2][3] of the C order buffer
+		check(matrix.at(position(4, 3, 2)) == 23.0f && matrix.at(position(2, 3, 1)) == 9.0f, "row major values");
+		{
+			MatrixND copy = matrix;
+		}
+		check(freedBuffers == 0, "adopted buffer kept while a copy is alive");
+
+		MatrixND_DLManagedTensor* tensor = matrix.toDLPack();
+		const MatrixND_DLTensor& dl = tensor->dl_tensor;
+		check(dl.data == data && dl.ndim == 3, "export shares the storage");
+		check(dl.shape[0] == 2 && dl.shape[1] == 3 && dl.shape[2] == 4, "export shape is C order");
+		check(dl.strides[0] == 12 && dl.strides[1] == 4 && dl.strides[2] == 1, "export strides are C order");
+
+		MatrixND roundTrip(tensor);
+		check(roundTrip.getData() == data, "round trip used in place");
+		check(roundTrip.getDimensions()[0] == 4 && roundTrip.getDimensions()[2] == 2, "round trip dimensions");
+	}
+	check(freedBuffers == 1, "adopted buffer freed once every user is gone");
+}
+
+static void testCompactDLPack(void)
+{
+	float* data = makeRowMajor();
+	int64_t shape[3] = { 2, 3, 4 };
+	MatrixND_DLManagedTensor tensor;
+	tensor.dl_tensor.data = data;
+	tensor.dl_tensor.device.device_type = 1;
+	tensor.dl_tensor.device.device_id = 0;
+	tensor.dl_tensor.ndim = 3;
+	tensor.dl_tensor.dtype.code = 2;
+	tensor.dl_tensor.dtype.bits = 32;
+	tensor.dl_tensor.dtype.lanes = 1;
+	tensor.dl_tensor.shape = shape;
+	tensor.dl_tensor.strides = NULL;
+	tensor.dl_tensor.byte_offset = 0;
+	tensor.manager_ctx = NULL;
+	tensor.deleter = countTensor;
+	freedTensors = 0;
+	{
+		//No strides means compact C order
+		MatrixND matrix(&tensor);
+		check(matrix.getData() == data, "compact tensor used in place");
+		check(matrix.getDimensions()[0] == 4 && matrix.getDimensions()[1] == 3 && matrix.getDimensions()[2] == 2, "compact tensor dimensions reversed");
+		check(matrix.at(position(4, 3, 2)) == 23.0f, "compact tensor values");
+	}
+	check(freedTensors == 1, "tensor deleter called when done");
+
+	//Anything but float32 on the CPU gives an empty matrix and is released at once
+	freedTensors = 0;
+	tensor.dl_tensor.dtype.bits = 64;
+	MatrixND unsupported(&tensor);
+	check(unsupported.getElements() == 0 && freedTensors == 1, "unsupported tensor refused");
+	delete[] data;
+}
+
+static void testStridedGathered(void)
+{
+	//Every other value of a 12 float buffer, viewed as {2, 3}
+	float* data = new float[12];
+	for (UINT32 i = 0; i < 12; i++)
+	{
+		data[i] = (float)i;
+	}
+	std::vector<UINT32> dimensions(2, 2);
+	dimensions.at(1) = 3;
+	std::vector<UINT32> strides(2, 2);
+	strides.at(1) = 4;
+	freedBuffers = 0;
+	MatrixND matrix(data, dimensions, strides, countBuffer);
+	check(matrix.getData() != data, "strided buffer gathered");
+	check(freedBuffers == 1, "gathered buffer handed back right away");
+	std::vector<UINT32> last(2, 2);
+	last.at(1) = 3;
+	check(matrix.at(0) == 0.0f && matrix.at(1) == 2.0f && matrix.at(last) == 10.0f, "gathered values");
+}
+
+int main()
+{
+	testRowMajorInPlace();
+	testCompactDLPack();
+	testStridedGathered();
+
+	if (failures == 0)
+		printf("All buffer checks passed\n");
+	return failures;
+}
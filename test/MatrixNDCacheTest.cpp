@@ -0,0 +1,82 @@
+/*****************************************Comment**********************************************
+*Tests for MatrixNDCache
+*Purpose:  To make sure cached results cannot be changed through the matrices built from them
+*Build: g++ -std=c++11 -I../src ../src/MatrixND.cpp MatrixNDCacheTest.cpp -o MatrixNDCacheTest
+*Returns zero when every check passes
+****************************************End Comment********************************************/
+#include "MatrixND.h"
+#include <cstdio>
+
+static int failures = 0;
+
+static void check(bool condition, const char* name)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", name);
+		failures++;
+	}
+}
+
+static MatrixND makeMatrix(std::vector<UINT32> dimensions, float start)
+{
+	MatrixND matrix(dimensions);
+	for (UINT32 i = 0; i < matrix.getElements(); i++)
+	{
+		matrix.at(i) = start + i;
+	}
+	return matrix;
+}
+
+int main()
+{
+	std::vector<UINT32> dimensions(2, 3);
+	MatrixND a = makeMatrix(dimensions, 1.0f);
+	MatrixND b = makeMatrix(dimensions, -2.0f);
+	MatrixNDCache cache(1 << 20);
+
+	CachedMatrixND first = cache.multiply(a, b);
+	MatrixND expected = first.toMatrix();
+
+	//Scaling a copy of a hit must leave the cached product alone
+	MatrixND scaled = cache.multiply(a, b).toMatrix();
+	scaled *= 2.0f;
+	check(cache.multiply(a, b).equals(expected), "scaling a copy of a hit");
+
+	//So must adding to one
+	MatrixND summed = cache.multiply(a, b).toMatrix();
+	summed += b;
+	check(cache.multiply(a, b).equals(expected), "adding to a copy of a hit");
+
+	check(cache.getHits() == 4 && cache.getMisses() == 1, "hit and miss counts");
+
+	//A changed operand misses and gives its own product
+	MatrixND changed = makeMatrix(dimensions, 1.0f);
+	changed.at(0) = 10.0f;
+	check(!cache.multiply(changed, b).equals(expected), "changed operand");
+
+	//Operands holding the same values in different shapes are told apart
+	std::vector<UINT32> wide(2, 2);
+	wide.at(1) = 3;
+	std::vector<UINT32> tall(2, 3);
+	tall.at(1) = 2;
+	OperatingDimensions_t dims(1, 2);
+	CachedMatrixND wideTranspose = cache.transpose(makeMatrix(wide, 0.0f), dims);
+	CachedMatrixND tallTranspose = cache.transpose(makeMatrix(tall, 0.0f), dims);
+	check(wideTranspose.getDimensions()[0] == 3 && tallTranspose.getDimensions()[0] == 2, "same values in different shapes");
+
+	//-0 and +0 compare equal so they must find the same entry
+	MatrixND positiveZero = makeMatrix(dimensions, 1.0f);
+	MatrixND negativeZero = makeMatrix(dimensions, 1.0f);
+	positiveZero.at(0) = 0.0f;
+	negativeZero.at(0) = -0.0f;
+	check(positiveZero.equals(negativeZero) && positiveZero.contentHash() == negativeZero.contentHash(), "signed zeros hash alike");
+	uint64_t hitsBefore = cache.getHits();
+	cache.multiply(positiveZero, b);
+	cache.multiply(negativeZero, b);
+	check(cache.getHits() == hitsBefore + 1, "signed zeros share a cache entry");
+
+	if (failures == 0)
+		printf("All MatrixNDCache checks passed\n");
+	return failures;
+}